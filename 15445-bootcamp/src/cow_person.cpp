@@ -0,0 +1,221 @@
+// 写时复制（copy-on-write）的 Person 教程代码
+
+// move_constructors.cpp 中的 Person 删除了拷贝构造函数和拷贝赋值运算符，
+// 因为深拷贝 nicknames_ 代价很大：每个 std::string 都要重新分配内存并复制字节。
+// 但有些场景确实需要很多"逻辑上的副本"，而且这些副本几乎不会被修改，
+// 比如保存快照、把同一个对象分发给多个消费者。
+//
+// 在这个文件中，我们给出一种"选择性启用"的做法：CowPerson。
+// - nicknames 存放在一个不可变的、带引用计数的块 NicknameBlock 中；
+// - Clone() 只是让引用计数原子地加一，新旧两个 CowPerson 共享同一个块；
+// - 第一次修改时（SetNicknameAtI / AddNickname），如果块被多个对象共享，
+//   就先深拷贝出一个只属于自己的块（detach），再修改，别的副本不受影响；
+// - 移动构造和移动赋值仍然只是"偷走"指针，和 Person 一样便宜。
+// 原来的 Person 保持不变，需要廉价副本的代码显式地使用 CowPerson。
+//
+// 编译：g++ -std=c++17 -O2 -pthread cow_person.cpp -o cow_person
+
+#include<iostream>
+#include<utility>
+#include<atomic>
+#include<string>
+#include<cstdint>
+#include<vector>
+#include<chrono>
+
+// 带引用计数的 nickname 块。引用计数和数据放在同一次分配里，
+// 相比 std::shared_ptr<std::vector<std::string>>（控制块和对象可能分开分配）少一次间接访问。
+class NicknameBlock{
+public:
+    explicit NicknameBlock(std::vector<std::string> &&nicknames)
+    : refcount_(1), nicknames_(std::move(nicknames)) {}
+
+    // 新的引用只能由已经持有引用的线程产生，所以加一用 relaxed 就够了
+    void Ref() {refcount_.fetch_add(1, std::memory_order_relaxed);}
+
+    // 减到 0 的那个线程负责释放。acq_rel 保证其他线程在释放引用之前对块的读
+    // 都发生在 delete 之前。
+    void Unref(){
+        if(refcount_.fetch_sub(1, std::memory_order_acq_rel) == 1){
+            delete this;
+        }
+    }
+
+    bool IsShared() const {return refcount_.load(std::memory_order_acquire) != 1;}
+
+    const std::vector<std::string> &Nicknames() const {return nicknames_;}
+    std::vector<std::string> &MutableNicknames() {return nicknames_;}
+
+private:
+    std::atomic<uint32_t> refcount_;
+    std::vector<std::string> nicknames_;
+};
+
+class CowPerson{
+public:
+    CowPerson() : age_(0), block_(nullptr), valid_(true) {}
+
+    // 与 Person 相同，接收右值 vector，不会深拷贝。
+    CowPerson(uint32_t age, std::vector<std::string> &&nicknames)
+    : age_(age), block_(new NicknameBlock(std::move(nicknames))), valid_(true) {}
+
+    // 移动构造函数：直接偷走块指针，引用计数不变。
+    CowPerson(CowPerson &&person)
+    : age_(person.age_), block_(person.block_), valid_(true) {
+        person.block_ = nullptr;
+        person.valid_ = false;
+    }
+
+    CowPerson &operator=(CowPerson &&other){
+        if(this != &other){
+            Release();
+            age_ = other.age_;
+            block_ = other.block_;
+            valid_ = true;
+            other.block_ = nullptr;
+            other.valid_ = false;
+        }
+        return *this;
+    }
+
+    // 仍然删除隐式的拷贝操作：副本必须通过 Clone() 显式创建，
+    // 这样读代码的人一眼就能看出这里产生了一个共享数据的副本。
+    CowPerson(const CowPerson&) = delete;
+    CowPerson &operator=(const CowPerson&) = delete;
+
+    ~CowPerson() {Release();}
+
+    // 廉价副本：只有一次原子加一。
+    CowPerson Clone() const{
+        CowPerson copy;
+        copy.age_ = age_;
+        copy.block_ = block_;
+        if(block_ != nullptr){
+            block_->Ref();
+        }
+        return copy;
+    }
+
+    uint32_t GetAge() {return age_;}
+
+    // 只读访问不会触发复制，因此返回 const 引用。
+    const std::string &GetNicknameAtI(size_t i) const {return block_->Nicknames()[i];}
+    size_t GetNicknameCount() const {return block_ == nullptr ? 0 : block_->Nicknames().size();}
+
+    // 可写访问：第一次修改共享的块之前先 detach。
+    // 这里故意不提供返回 std::string& 的接口：调用者拿到引用后如果又 Clone() 了一次，
+    // 块重新变成共享的，再通过旧引用写入就会悄悄改掉副本的数据。整体替换的 setter 每次都会检查。
+    void SetNicknameAtI(size_t i, std::string &&nickname) {Detach()[i] = std::move(nickname);}
+    void AddNickname(std::string &&nickname) {Detach().push_back(std::move(nickname));}
+
+    // 两个 CowPerson 是否共享同一个 nickname 块（仅用于演示）
+    bool SharesNicknamesWith(const CowPerson &other) const {return block_ == other.block_;}
+
+    void PrintValid(){
+        if(valid_){
+            std::cout << "Person object valid. " << std::endl;
+        }else{
+            std::cout << "Person object invalid. " << std::endl;
+        }
+    }
+
+private:
+    // 确保当前对象独占 nickname 块，返回可以修改的 vector。
+    std::vector<std::string> &Detach(){
+        if(block_ == nullptr){
+            block_ = new NicknameBlock({});
+        }else if(block_->IsShared()){
+            // 这里才真正发生深拷贝，而且只发生一次：之后 block_ 已经只属于自己了
+            std::vector<std::string> copy = block_->Nicknames();
+            NicknameBlock *own = new NicknameBlock(std::move(copy));
+            block_->Unref();
+            block_ = own;
+        }
+        return block_->MutableNicknames();
+    }
+
+    void Release(){
+        if(block_ != nullptr){
+            block_->Unref();
+            block_ = nullptr;
+        }
+    }
+
+    uint32_t age_;
+    NicknameBlock *block_;
+    bool valid_;
+};
+
+// 作为对照：没有共享存储时，得到一个副本只能深拷贝整个 vector。
+std::vector<std::string> DeepCopy(const std::vector<std::string> &nicknames){
+    return std::vector<std::string>(nicknames);
+}
+
+std::vector<std::string> MakeNicknames(size_t n){
+    std::vector<std::string> v;
+    for(size_t i = 0; i < n; i++){
+        // 足够长，超出短字符串优化（SSO）的范围，每个字符串都要单独分配堆内存
+        v.push_back("nickname-number-" + std::to_string(i) + "-of-andy-pavlo");
+    }
+    return v;
+}
+
+int main(){
+    // 首先演示语义：clone 共享数据，修改时才分离
+    CowPerson andy(15445, {"andy", "pavlo"});
+    CowPerson snapshot = andy.Clone();
+    std::cout << "andy and snapshot share nicknames: " << andy.SharesNicknamesWith(snapshot) << std::endl;
+
+    andy.SetNicknameAtI(0, "andrew");
+    std::cout << "after mutation, share nicknames: " << andy.SharesNicknamesWith(snapshot) << std::endl;
+    std::cout << "andy's nickname 0: " << andy.GetNicknameAtI(0)
+              << ", snapshot's nickname 0: " << snapshot.GetNicknameAtI(0) << std::endl;
+
+    // 移动仍然只是偷指针，被移动的对象失效
+    CowPerson andy2(std::move(andy));
+    std::cout << "Print validity for andy2: ";
+    andy2.PrintValid();
+    std::cout << "Print validity for andy: ";
+    andy.PrintValid();
+
+    // 然后比较 clone 与深拷贝的开销
+    const size_t kNicknames = 16;
+    const size_t kIters = 200000;
+    std::vector<std::string> source = MakeNicknames(kNicknames);
+    CowPerson cow(15445, MakeNicknames(kNicknames));
+
+    size_t sink = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < kIters; i++){
+        std::vector<std::string> copy = DeepCopy(source);
+        sink += copy.size();
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < kIters; i++){
+        CowPerson copy = cow.Clone();
+        sink += copy.GetNicknameCount();
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    // clone 之后立刻修改：最坏情况，clone 的好处全部被第一次修改的 detach 抵消
+    for(size_t i = 0; i < kIters; i++){
+        CowPerson copy = cow.Clone();
+        copy.SetNicknameAtI(0, copy.GetNicknameAtI(0) + "!");
+        sink += copy.GetNicknameCount();
+    }
+    auto t3 = std::chrono::steady_clock::now();
+    // 已经独占的对象反复修改：不会再发生复制
+    CowPerson owner = cow.Clone();
+    owner.SetNicknameAtI(0, "N");
+    for(size_t i = 0; i < kIters; i++){
+        owner.SetNicknameAtI(i % kNicknames, "N");
+    }
+    auto t4 = std::chrono::steady_clock::now();
+
+    auto ns = [&](auto a, auto b){return std::chrono::duration<double, std::nano>(b - a).count() / kIters;};
+    std::cout << "deep copy of " << kNicknames << " nicknames: " << ns(t0, t1) << " ns" << std::endl;
+    std::cout << "CowPerson::Clone:                " << ns(t1, t2) << " ns" << std::endl;
+    std::cout << "Clone + first mutation (detach): " << ns(t2, t3) << " ns" << std::endl;
+    std::cout << "mutation of unshared block:      " << ns(t3, t4) << " ns" << std::endl;
+    std::cout << "(sink " << sink << ")" << std::endl;
+    return 0;
+}
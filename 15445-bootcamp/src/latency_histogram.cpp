@@ -0,0 +1,301 @@
+// 延迟直方图埋点的教程代码
+
+// 前面的文件里，我们只能看到"平均"有多快，却看不到尾延迟（tail latency）：
+// 比如 Person 的构造、移动、GetNicknameAtI，以及 move_semantics.cpp 里对 vector 的变换，
+// 偶尔一次慢操作（缺页、分配器加锁、被调度走）在平均值里完全看不出来。
+//
+// 这个文件实现一个低开销的埋点层：
+// - LATENCY_SCOPE("name") 在当前作用域开始和结束时各读一次时钟（x86 上用 RDTSC，否则用 steady_clock）；
+// - 每个线程有自己的直方图，记录时只写本线程的数据，没有锁，也没有原子读-改-写指令；
+// - 直方图按 HDR（High Dynamic Range）的思路分桶：每个 2 的幂区间再平分成 8 个子桶，
+//   相对误差不超过 12.5%，512 个桶就能覆盖整个 64 位范围；
+// - 报告时把所有线程的直方图合并（只读，不需要让记录线程停下来），导出 p50/p99/p999/max 的 JSON；
+// - 不定义 ENABLE_LATENCY_HISTOGRAM 时，LATENCY_SCOPE 展开为空，埋点完全从代码中消失。
+//
+// 启用时每个作用域的开销并不是"几纳秒"：它的下限是两次读时钟。在物理机上 RDTSC 只要十几个周期，
+// 但在虚拟机里 RDTSC 常被 hypervisor 截获，单次读取约 17~20 ns，每个作用域因此约 40 ns。
+// 所以只应该给本身在百纳秒以上的操作埋点，被测操作越短，测到的延迟里埋点自身的比例越大。
+//
+// 编译（启用）：g++ -std=c++17 -O2 -pthread -DENABLE_LATENCY_HISTOGRAM latency_histogram.cpp -o latency_histogram
+// 编译（关闭）：g++ -std=c++17 -O2 -pthread latency_histogram.cpp -o latency_histogram
+
+#include<iostream>
+#include<utility>
+#include<atomic>
+#include<array>
+#include<string>
+#include<sstream>
+#include<cstdint>
+#include<vector>
+#include<thread>
+#include<chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include<x86intrin.h>  // __rdtsc
+#endif
+
+#include "person.h"
+
+namespace latency{
+
+// 读取一个单调递增的时间戳。在物理机上 RDTSC 只需要十几个周期，而 steady_clock::now() 通常要走 vDSO，
+// 前者的开销小得多（虚拟机里的情况见文件开头）。
+inline uint64_t Now(){
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+// 时间戳单位到纳秒的换算系数。RDTSC 的频率因机器而异，第一次调用时和 steady_clock 对比校准一次。
+inline double NanosPerTick(){
+    static const double ratio = [](){
+#if defined(__x86_64__) || defined(__i386__)
+        auto c0 = std::chrono::steady_clock::now();
+        uint64_t t0 = Now();
+        while(std::chrono::steady_clock::now() - c0 < std::chrono::milliseconds(20)){}
+        uint64_t t1 = Now();
+        auto c1 = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(c1 - c0).count() / static_cast<double>(t1 - t0);
+#else
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::duration(1)).count();
+#endif
+    }();
+    return ratio;
+}
+
+// 每个 2 的幂区间的子桶数为 2^kSubBucketBits
+constexpr uint32_t kSubBucketBits = 3;
+constexpr uint32_t kSubBuckets = 1u << kSubBucketBits;
+constexpr uint32_t kBuckets = 64 * kSubBuckets;
+// 最多可以埋点的操作种类数
+constexpr uint32_t kMaxOps = 32;
+
+// 值 -> 桶编号。小于 kSubBuckets 的值每个值一个桶（精确）；
+// 更大的值按最高位所在的位置分组，再取最高位之后的 kSubBucketBits 位作为子桶。
+inline uint32_t BucketOf(uint64_t v){
+    if(v < kSubBuckets){
+        return static_cast<uint32_t>(v);
+    }
+    uint32_t msb = 63 - static_cast<uint32_t>(__builtin_clzll(v));
+    uint32_t sub = static_cast<uint32_t>(v >> (msb - kSubBucketBits)) & (kSubBuckets - 1);
+    return (msb - kSubBucketBits + 1) * kSubBuckets + sub;
+}
+
+// 桶编号 -> 这个桶所代表的最大值（报告分位数时用上界，宁可高估也不低估延迟）
+inline uint64_t BucketUpperBound(uint32_t b){
+    if(b < kSubBuckets){
+        return b;
+    }
+    uint32_t msb = b / kSubBuckets + kSubBucketBits - 1;
+    uint64_t sub = b % kSubBuckets;
+    uint64_t low = (uint64_t{1} << msb) | (sub << (msb - kSubBucketBits));
+    return low + (uint64_t{1} << (msb - kSubBucketBits)) - 1;
+}
+
+// 单个线程的直方图。只有拥有它的线程会写，报告线程只读。
+// 计数器用 std::atomic 只是为了让并发读写是合法的；写入用 load + store（relaxed），
+// 在 x86 上就是普通的 mov，不会产生带 lock 前缀的指令。
+struct ThreadHistograms{
+    std::array<std::array<std::atomic<uint64_t>, kBuckets>, kMaxOps> counts{};
+    std::array<std::atomic<uint64_t>, kMaxOps> max{};
+    ThreadHistograms *next = nullptr;
+
+    void Record(uint32_t op, uint64_t ticks){
+        auto &c = counts[op][BucketOf(ticks)];
+        c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if(ticks > max[op].load(std::memory_order_relaxed)){
+            max[op].store(ticks, std::memory_order_relaxed);
+        }
+    }
+};
+
+// 所有线程直方图组成的无锁单链表。线程第一次记录时用 CAS 把自己的直方图挂到表头；
+// 直方图永不释放（线程退出后它的数据仍然要参与报告）。
+inline std::atomic<ThreadHistograms *> &Registry(){
+    static std::atomic<ThreadHistograms *> head{nullptr};
+    return head;
+}
+
+inline ThreadHistograms &Local(){
+    thread_local ThreadHistograms *local = [](){
+        auto *h = new ThreadHistograms();
+        h->next = Registry().load(std::memory_order_relaxed);
+        while(!Registry().compare_exchange_weak(h->next, h, std::memory_order_release, std::memory_order_relaxed)){}
+        return h;
+    }();
+    return *local;
+}
+
+// 操作名字表。每个 LATENCY_SCOPE 展开处用一个函数内 static 变量只注册一次。
+inline std::array<std::atomic<const char *>, kMaxOps> &OpNames(){
+    static std::array<std::atomic<const char *>, kMaxOps> names{};
+    return names;
+}
+
+inline uint32_t RegisterOp(const char *name){
+    static std::atomic<uint32_t> next{0};
+    uint32_t id = next.fetch_add(1, std::memory_order_relaxed);
+    if(id >= kMaxOps){
+        std::cerr << "latency: too many ops, \"" << name << "\" is folded into op 0" << std::endl;
+        return 0;
+    }
+    OpNames()[id].store(name, std::memory_order_release);
+    return id;
+}
+
+// 作用域计时器：构造时读时钟，析构时再读一次并记录差值。
+class ScopedTimer{
+public:
+    explicit ScopedTimer(uint32_t op) : op_(op), start_(Now()) {}
+    ~ScopedTimer() {Local().Record(op_, Now() - start_);}
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer &operator=(const ScopedTimer&) = delete;
+
+private:
+    uint32_t op_;
+    uint64_t start_;
+};
+
+// 合并所有线程的直方图并导出 JSON，单位是纳秒。
+inline std::string ReportJson(){
+    std::array<std::array<uint64_t, kBuckets>, kMaxOps> merged{};
+    std::array<uint64_t, kMaxOps> max{};
+    for(auto *h = Registry().load(std::memory_order_acquire); h != nullptr; h = h->next){
+        for(uint32_t op = 0; op < kMaxOps; op++){
+            for(uint32_t b = 0; b < kBuckets; b++){
+                merged[op][b] += h->counts[op][b].load(std::memory_order_relaxed);
+            }
+            uint64_t m = h->max[op].load(std::memory_order_relaxed);
+            max[op] = m > max[op] ? m : max[op];
+        }
+    }
+
+    const double ns = NanosPerTick();
+    std::ostringstream out;
+    out << "{";
+    bool first = true;
+    for(uint32_t op = 0; op < kMaxOps; op++){
+        const char *name = OpNames()[op].load(std::memory_order_acquire);
+        uint64_t total = 0;
+        for(uint64_t c : merged[op]){
+            total += c;
+        }
+        if(name == nullptr || total == 0){
+            continue;
+        }
+        // 依次找到累计计数第一次达到 q * total 的桶
+        const double qs[] = {0.5, 0.99, 0.999};
+        uint64_t pct[3] = {0, 0, 0};
+        uint64_t seen = 0;
+        size_t qi = 0;
+        for(uint32_t b = 0; b < kBuckets && qi < 3; b++){
+            seen += merged[op][b];
+            while(qi < 3 && static_cast<double>(seen) >= qs[qi] * static_cast<double>(total)){
+                pct[qi++] = BucketUpperBound(b);
+            }
+        }
+        out << (first ? "" : ",") << "\n  \"" << name << "\": {\"count\": " << total
+            << ", \"p50_ns\": " << pct[0] * ns << ", \"p99_ns\": " << pct[1] * ns
+            << ", \"p999_ns\": " << pct[2] * ns << ", \"max_ns\": " << max[op] * ns << "}";
+        first = false;
+    }
+    out << "\n}";
+    return out.str();
+}
+
+}  // namespace latency
+
+// 宏的两层拼接是为了让 __LINE__ 先展开成数字，这样同一个函数里可以有多个 LATENCY_SCOPE。
+#define LATENCY_CONCAT_INNER(a, b) a##b
+#define LATENCY_CONCAT(a, b) LATENCY_CONCAT_INNER(a, b)
+
+#if defined(ENABLE_LATENCY_HISTOGRAM)
+#define LATENCY_SCOPE(name)                                                                   \
+    static const uint32_t LATENCY_CONCAT(latency_op_, __LINE__) = latency::RegisterOp(name); \
+    latency::ScopedTimer LATENCY_CONCAT(latency_timer_, __LINE__)(LATENCY_CONCAT(latency_op_, __LINE__))
+#else
+#define LATENCY_SCOPE(name) ((void)0)
+#endif
+
+// move_semantics.cpp 里的 move_add_three_and_print，去掉打印后加上埋点
+size_t move_add_three(std::vector<int> &&vec){
+    LATENCY_SCOPE("move_add_three");
+    std::vector<int> vec1 = std::move(vec);
+    vec1.push_back(3);
+    return vec1.size();
+}
+
+int main(){
+    const size_t kIters = 1000000;
+    std::atomic<size_t> sink{0};
+
+    // 在多个线程中埋点：每个线程写自己的直方图，最后统一合并
+    std::vector<std::thread> workers;
+    for(int t = 0; t < 2; t++){
+        workers.emplace_back([&sink, t](){
+            size_t local = 0;
+            for(size_t i = 0; i < kIters / 10; i++){
+                Person p = [&](){
+                    LATENCY_SCOPE("Person(uint32_t, vector&&)");
+                    return Person(15445 + t, {"andy", "pavlo"});
+                }();
+                {
+                    LATENCY_SCOPE("GetNicknameAtI");
+                    local += p.GetNicknameAtI(i % 2).size();
+                }
+                local += move_add_three({1, 2, 3, 4});
+            }
+            sink += local;
+        });
+    }
+    for(auto &w : workers){
+        w.join();
+    }
+
+    // 测量埋点本身的开销：同样是来回移动一个 Person，一个循环带 LATENCY_SCOPE，一个不带。
+    // 空的 asm volatile 是编译器屏障，防止优化器把整个循环看穿并删掉。
+    Person a(15445, {"andy", "pavlo"});
+    Person b;
+    auto t0 = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < kIters; i++){
+        b = std::move(a);
+        a = std::move(b);
+        asm volatile("" ::: "memory");
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < kIters; i++){
+        LATENCY_SCOPE("Person move assignment x2");
+        b = std::move(a);
+        a = std::move(b);
+        asm volatile("" ::: "memory");
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    // 埋点的开销下限是两次读时钟。在虚拟机里 RDTSC 可能被截获，单次就要十几纳秒，
+    // 所以把时钟本身的开销单独打印出来，便于和上面的差值对照。
+    uint64_t clock_sum = 0;
+    for(size_t i = 0; i < kIters; i++){
+        clock_sum += latency::Now();
+    }
+    auto t3 = std::chrono::steady_clock::now();
+    sink += a.GetAge() + (clock_sum & 1);
+
+    auto ns = [&](auto x, auto y){return std::chrono::duration<double, std::nano>(y - x).count() / kIters;};
+#if defined(ENABLE_LATENCY_HISTOGRAM)
+    std::cout << latency::ReportJson() << std::endl;
+#else
+    std::cout << "latency histogram disabled (compile with -DENABLE_LATENCY_HISTOGRAM)" << std::endl;
+#endif
+    std::cout << "two moves, plain:        " << ns(t0, t1) << " ns" << std::endl;
+    std::cout << "two moves, instrumented: " << ns(t1, t2) << " ns" << std::endl;
+#if defined(ENABLE_LATENCY_HISTOGRAM)
+    std::cout << "overhead per scope:      " << ns(t1, t2) - ns(t0, t1) << " ns" << std::endl;
+#else
+    // 关闭时两个循环完全相同，差值只是测量噪声
+    std::cout << "noise baseline (disabled, both loops identical): " << ns(t1, t2) - ns(t0, t1) << " ns" << std::endl;
+#endif
+    std::cout << "cost of one clock read:  " << ns(t2, t3) << " ns" << std::endl;
+    std::cout << "(sink " << sink.load() << ")" << std::endl;
+    return 0;
+}
@@ -0,0 +1,65 @@
+// 第三部分各个练习文件共用的 Person 类
+
+// 接口与 move_constructors.cpp 中的 Person 相同，只是去掉了移动构造和移动赋值中的打印：
+// 这些练习会在批量加载、容器扩容、基准测试中调用移动操作成千上万次，打印本身是微秒级的，
+// 既会淹没输出，也会掩盖被测操作的真实开销。
+// 另外补充了几个批量处理需要的访问函数。
+
+#pragma once
+
+#include<iostream>
+#include<utility>
+#include<string>
+#include<cstdint>
+#include<vector>
+
+class Person{
+public:
+    Person() : age_(0), nicknames_({}), valid_(true) {}
+
+    // 接收右值 vector，构造时不会深拷贝 nicknames
+    Person(uint32_t age, std::vector<std::string> &&nicknames)
+    :age_(age), nicknames_(std::move(nicknames)), valid_(true) {}
+
+    Person(Person &&person)
+    : age_(person.age_), nicknames_(std::move(person.nicknames_)), valid_(true) {
+        person.valid_ = false;
+    }
+
+    Person &operator=(Person &&other){
+        age_ = other.age_;
+        nicknames_ = std::move(other.nicknames_);
+        valid_ = true;
+        other.valid_ = false;
+        return *this;
+    }
+
+    Person(const Person&) = delete;
+    Person &operator=(const Person&) = delete;
+
+    uint32_t GetAge() {return age_;}
+    std::string &GetNicknameAtI(size_t i) {return nicknames_[i];}
+    size_t GetNicknameCount() const {return nicknames_.size();}
+
+    // 只读地访问整个 nicknames_，批量接口用它拿到 vector 的大小和数据指针
+    const std::vector<std::string> &GetNicknames() const {return nicknames_;}
+
+    // 把 nicknames_ 移交给调用者，之后这个对象不再有效
+    std::vector<std::string> TakeNicknames(){
+        valid_ = false;
+        return std::move(nicknames_);
+    }
+
+    void PrintValid(){
+        if(valid_){
+            std::cout << "Person object valid. " << std::endl;
+        }else{
+            std::cout << "Person object invalid. " << std::endl;
+        }
+    }
+
+private:
+    uint32_t age_;
+    std::vector<std::string> nicknames_;
+    bool valid_;        // 跟踪对象的数据是否有效，即是否所有数据都已转移到另一个实例
+};
@@ -0,0 +1,226 @@
+// Person 批量构造与批量移出的教程代码
+
+// move_constructors.cpp 中每个 Person 都是单独构造的：
+// 要么用 Person(uint32_t, std::vector<std::string>&&)，
+// 要么像 main 里的 andy1 那样，先默认构造、再移动赋值。后一种写法对每个对象都要
+// 先写一遍 age_/nicknames_/valid_ 的默认值，再在移动赋值里重新写一遍（原代码里还会打印一行）。
+// 如果是 std::vector<Person> v(n) 再逐个赋值，这个"白写一遍"的开销就乘以 n。
+//
+// 这个文件实现一个 PersonBatch 容器：
+// - 从两组平行的数组（ages 和被移入的 nickname vector）构造，只做一次内存分配；
+// - 每个 Person 用 placement new 直接在最终位置上构造，没有"默认构造再赋值"这一步，
+//   也不会因为扩容而移动已经构造好的 Person；
+// - 可选地用多个线程并行填充，每个线程负责一段连续的区间；
+// - Drain 把整批数据（age 和 nickname vector）一次性移出，同时销毁 Person，批次变为空；
+// - PersonBatch 自己的移动构造只是偷走缓冲区指针。
+//
+// 编译：g++ -std=c++17 -O2 -pthread person_batch.cpp -o person_batch
+
+#include<iostream>
+#include<utility>
+#include<cstdint>
+#include<memory>
+#include<new>
+#include<string>
+#include<thread>
+#include<chrono>
+#include<vector>
+
+#include "person.h"
+
+class PersonBatch{
+public:
+    PersonBatch() : data_(nullptr), size_(0) {}
+
+    // 每个线程至少要分到这么多个对象，否则创建线程的开销比构造本身还大
+    static constexpr size_t kMinPerThread = 16384;
+
+    // 构造 n 个对象时实际使用的线程数：不超过 threads，也不超过 n / kMinPerThread，至少为 1。
+    static size_t EffectiveThreads(size_t n, size_t threads){
+        if(threads > n / kMinPerThread){
+            threads = n / kMinPerThread;
+        }
+        return threads == 0 ? 1 : threads;
+    }
+
+    // 从平行数组构造 n 个 Person。nicknames[i] 被移动进第 i 个 Person，调用后处于被移动后的状态。
+    // threads > 1 且 n 足够大时并行填充，实际线程数见 EffectiveThreads。
+    PersonBatch(const uint32_t *ages, std::vector<std::string> *nicknames, size_t n, size_t threads = 1)
+    : data_(n == 0 ? nullptr : std::allocator<Person>().allocate(n)), size_(n) {
+        threads = EffectiveThreads(n, threads);
+        if(threads == 1){
+            Fill(ages, nicknames, 0, n);
+            return;
+        }
+        std::vector<std::thread> workers;
+        for(size_t t = 0; t < threads; t++){
+            size_t begin = n * t / threads;
+            size_t end = n * (t + 1) / threads;
+            workers.emplace_back([this, ages, nicknames, begin, end](){Fill(ages, nicknames, begin, end);});
+        }
+        for(auto &w : workers){
+            w.join();
+        }
+    }
+
+    // 移动构造和移动赋值只交换缓冲区指针，与 Person 自己的移动语义保持一致。
+    PersonBatch(PersonBatch &&other) : data_(other.data_), size_(other.size_) {
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+
+    PersonBatch &operator=(PersonBatch &&other){
+        if(this != &other){
+            Clear();
+            data_ = other.data_;
+            size_ = other.size_;
+            other.data_ = nullptr;
+            other.size_ = 0;
+        }
+        return *this;
+    }
+
+    PersonBatch(const PersonBatch&) = delete;
+    PersonBatch &operator=(const PersonBatch&) = delete;
+
+    ~PersonBatch() {Clear();}
+
+    size_t Size() const {return size_;}
+    Person &operator[](size_t i) {return data_[i];}
+
+    // 把整批数据移出，追加到 ages_out 和 nicknames_out 的末尾，第 i 个 Person 的内容在原有元素之后的第 i 个位置。
+    // 两个输出先 reserve 一次，再逐个 emplace_back：nickname vector 直接移动构造在最终位置上，
+    // 调用者不需要先准备 n 个默认构造的空 vector 再让这里移动赋值。
+    // 移出和销毁在同一遍循环里完成，每个对象只被访问一次。调用后批次为空。
+    // 注意 nickname 的堆内存并没有释放，而是转交给了 nicknames_out，由调用者负责。
+    void Drain(std::vector<uint32_t> &ages_out, std::vector<std::vector<std::string>> &nicknames_out){
+        ages_out.reserve(ages_out.size() + size_);
+        nicknames_out.reserve(nicknames_out.size() + size_);
+        for(size_t i = 0; i < size_; i++){
+            ages_out.push_back(data_[i].GetAge());
+            nicknames_out.emplace_back(data_[i].TakeNicknames());
+            data_[i].~Person();
+        }
+        Deallocate();
+    }
+
+private:
+    void Fill(const uint32_t *ages, std::vector<std::string> *nicknames, size_t begin, size_t end){
+        for(size_t i = begin; i < end; i++){
+            new (&data_[i]) Person(ages[i], std::move(nicknames[i]));
+        }
+    }
+
+    void Clear(){
+        for(size_t i = 0; i < size_; i++){
+            data_[i].~Person();
+        }
+        Deallocate();
+    }
+
+    void Deallocate(){
+        if(data_ != nullptr){
+            std::allocator<Person>().deallocate(data_, size_);
+        }
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    Person *data_;
+    size_t size_;
+};
+
+// 生成 n 份 nickname 输入。每次构造都会把它们移走，所以每轮都要重新生成（不计入计时）。
+void MakeInput(size_t n, std::vector<uint32_t> &ages, std::vector<std::vector<std::string>> &nicknames){
+    ages.resize(n);
+    nicknames.resize(n);
+    for(size_t i = 0; i < n; i++){
+        ages[i] = static_cast<uint32_t>(18 + i % 60);
+        nicknames[i] = {"andy", "pavlo"};
+    }
+}
+
+template<typename F>
+double TimeNs(F &&f){
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(){
+    // 首先演示用法
+    std::vector<uint32_t> ages = {15445, 15721};
+    std::vector<std::vector<std::string>> nicknames = {{"andy", "pavlo"}, {"jignesh"}};
+    PersonBatch batch(ages.data(), nicknames.data(), ages.size());
+    std::cout << "batch[1]: age " << batch[1].GetAge() << ", nickname " << batch[1].GetNicknameAtI(0) << std::endl;
+
+    PersonBatch moved(std::move(batch));
+    std::cout << "after move, old batch size " << batch.Size() << ", new batch size " << moved.Size() << std::endl;
+
+    std::vector<uint32_t> ages_out;
+    std::vector<std::vector<std::string>> nicknames_out;
+    moved.Drain(ages_out, nicknames_out);
+    std::cout << "drained: " << ages_out[0] << " " << nicknames_out[0][1] << ", batch size now " << moved.Size()
+              << std::endl;
+
+    // 然后比较不同批大小下，每个 Person 的构造和销毁开销
+    size_t threads = std::thread::hardware_concurrency();
+    if(threads < 2){
+        threads = 2;
+    }
+    // teardown 一列对所有写法都包括释放 nickname 的堆内存。PersonBatch 的 Drain 只是把 nickname vector
+    // 移交给 out_nicks，真正的释放发生在 out_nicks 销毁时，所以这里把两者一起计时，并在括号里分别列出。
+    std::cout << "ns per Person (construct / teardown)" << std::endl;
+    for(size_t n = 1024; n <= (size_t{1} << 20); n *= 8){
+        std::vector<uint32_t> in_ages;
+        std::vector<std::vector<std::string>> in_nicks;
+        double per = static_cast<double>(n);
+
+        // 1. 与 andy1 相同的写法：先默认构造 n 个，再逐个移动赋值
+        MakeInput(n, in_ages, in_nicks);
+        std::vector<Person> assigned;
+        double a_build = TimeNs([&](){
+            assigned = std::vector<Person>(n);
+            for(size_t i = 0; i < n; i++){
+                assigned[i] = Person(in_ages[i], std::move(in_nicks[i]));
+            }
+        });
+        double a_tear = TimeNs([&](){assigned = std::vector<Person>();});
+
+        // 2. reserve 一次再 emplace_back
+        MakeInput(n, in_ages, in_nicks);
+        std::vector<Person> emplaced;
+        double e_build = TimeNs([&](){
+            emplaced.reserve(n);
+            for(size_t i = 0; i < n; i++){
+                emplaced.emplace_back(in_ages[i], std::move(in_nicks[i]));
+            }
+        });
+        double e_tear = TimeNs([&](){emplaced = std::vector<Person>();});
+
+        // 3. PersonBatch 单线程，拆成 Drain + 销毁移出的 nickname
+        MakeInput(n, in_ages, in_nicks);
+        PersonBatch single;
+        double s_build = TimeNs([&](){single = PersonBatch(in_ages.data(), in_nicks.data(), n);});
+        std::vector<uint32_t> out_ages;
+        std::vector<std::vector<std::string>> out_nicks;
+        double s_drain = TimeNs([&](){single.Drain(out_ages, out_nicks);});
+        double s_free = TimeNs([&](){out_nicks = std::vector<std::vector<std::string>>();});
+
+        // 4. PersonBatch 并行填充
+        MakeInput(n, in_ages, in_nicks);
+        PersonBatch parallel;
+        size_t used = PersonBatch::EffectiveThreads(n, threads);
+        double p_build = TimeNs([&](){parallel = PersonBatch(in_ages.data(), in_nicks.data(), n, threads);});
+        double p_tear = TimeNs([&](){parallel = PersonBatch();});
+
+        std::cout << "n = " << n << ":" << std::endl
+                  << "  default + move-assign: " << a_build / per << " / " << a_tear / per << std::endl
+                  << "  reserve + emplace:     " << e_build / per << " / " << e_tear / per << std::endl
+                  << "  PersonBatch:           " << s_build / per << " / " << (s_drain + s_free) / per
+                  << " (drain " << s_drain / per << " + free " << s_free / per << ")" << std::endl
+                  << "  PersonBatch parallel:  " << p_build / per << " / " << p_tear / per
+                  << " (" << used << (used == 1 ? " thread)" : " threads)") << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,437 @@
+// 分片的 Person 注册表 + 基于 epoch 的内存回收（EBR）教程代码
+
+// 把所有 Person 放在一个全局容器里，再用一把锁保护，在很多线程同时插入、查找、
+// 把记录移出时，这把锁就成了所有线程排队的地方。即使换成 std::shared_mutex，
+// 读者之间也要争抢同一个读计数器所在的缓存行。
+//
+// 这个文件实现一个分片（sharded）的注册表：
+// - 按 key 的哈希值选择分片，不同分片之间完全独立；
+// - 每个分片按缓存行对齐，写者（插入/删除）持有本分片的互斥锁（latch）；
+// - 读者不加任何锁，直接沿着链表读。这要求被删除的节点不能立刻 delete，
+//   因为可能还有读者正拿着指向它的指针；
+// - 被删除的节点交给 EpochManager，等所有可能看到它的读者都离开之后才真正释放。
+//
+// EBR 的基本思想：全局有一个递增的 epoch。线程在访问共享数据前"进入"（pin）当前 epoch，
+// 访问结束后"离开"。在 epoch e 中被摘下（retire）的节点，只有当全局 epoch 前进到 e + 2 时，
+// 才能保证再也没有读者持有它。只有当所有处于活动状态的线程都已经看到了当前 epoch，全局 epoch 才能前进。
+//
+// 编译：g++ -std=c++17 -O2 -pthread person_registry.cpp -o person_registry
+
+#include<iostream>
+#include<utility>
+#include<atomic>
+#include<array>
+#include<cassert>
+#include<cstdint>
+#include<cstdlib>
+#include<functional>
+#include<memory>
+#include<mutex>
+#include<optional>
+#include<shared_mutex>
+#include<string>
+#include<thread>
+#include<chrono>
+#include<unordered_map>
+#include<vector>
+
+#include "person.h"
+
+constexpr size_t kCacheLineSize = 64;
+
+// 基于 epoch 的内存回收。线程数有上限 kMaxThreads，每个线程占一个按缓存行对齐的槽位，
+// 避免不同线程更新自己的 epoch 时互相使对方的缓存行失效。
+// 线程通过 thread_local 记住自己的槽位，所以整个进程只能有一个 EpochManager，通过 Instance() 获取；
+// 所有注册表共享它，被退休的节点不依赖于它所属的注册表，注册表先析构也没有问题。
+class EpochManager{
+public:
+    static constexpr size_t kMaxThreads = 128;
+    // 每退休这么多个节点尝试推进一次全局 epoch
+    static constexpr size_t kAdvanceInterval = 64;
+
+    static EpochManager &Instance(){
+        static EpochManager mgr;
+        return mgr;
+    }
+
+    EpochManager(const EpochManager&) = delete;
+    EpochManager &operator=(const EpochManager&) = delete;
+
+    // 程序结束时已经没有并发访问，释放所有还没回收的节点
+    ~EpochManager(){
+        for(auto &slot : slots_){
+            for(auto &list : slot.limbo){
+                for(auto &deleter : list){
+                    deleter();
+                }
+            }
+        }
+    }
+
+    struct alignas(kCacheLineSize) Slot{
+        std::atomic<uint64_t> epoch{0};
+        std::atomic<bool> active{false};
+        std::atomic<bool> in_use{false};
+        // 以下字段只由拥有这个槽位的线程访问
+        std::array<std::vector<std::function<void()>>, 3> limbo;
+        std::array<uint64_t, 3> limbo_epoch{0, 0, 0};
+        size_t retired = 0;
+    };
+
+    // RAII 的临界区：构造时进入当前 epoch，析构时离开。同一线程内不支持嵌套。
+    class Guard{
+    public:
+        explicit Guard(EpochManager &mgr) : slot_(mgr.LocalSlot()) {mgr.Pin(slot_);}
+        ~Guard() {slot_.active.store(false, std::memory_order_release);}
+        Guard(const Guard&) = delete;
+        Guard &operator=(const Guard&) = delete;
+
+    private:
+        Slot &slot_;
+    };
+
+    // 在临界区内调用：把一个已经从数据结构中摘下的对象交给 EBR，稍后释放。
+    template<typename T>
+    void Retire(T *ptr){
+        Slot &slot = LocalSlot();
+        uint64_t e = slot.epoch.load(std::memory_order_relaxed);
+        size_t idx = e % 3;
+        // limbo[idx] 里如果是更早 epoch（最多是 e - 3）退休的对象，此时全局 epoch >= e，
+        // 已经满足"前进了两个 epoch"的条件，可以安全释放。
+        if(slot.limbo_epoch[idx] != e){
+            for(auto &deleter : slot.limbo[idx]){
+                deleter();
+            }
+            slot.limbo[idx].clear();
+            slot.limbo_epoch[idx] = e;
+        }
+        slot.limbo[idx].push_back([ptr](){delete ptr;});
+        if(++slot.retired % kAdvanceInterval == 0){
+            TryAdvance();
+        }
+    }
+
+    // 如果所有活动线程都已经进入了当前 epoch，就把全局 epoch 加一。
+    bool TryAdvance(){
+        uint64_t e = global_.load(std::memory_order_seq_cst);
+        for(auto &slot : slots_){
+            if(slot.active.load(std::memory_order_seq_cst) && slot.epoch.load(std::memory_order_seq_cst) != e){
+                return false;
+            }
+        }
+        return global_.compare_exchange_strong(e, e + 1, std::memory_order_seq_cst);
+    }
+
+    uint64_t GlobalEpoch() const {return global_.load();}
+
+    // 当前线程是否处在某个 Guard 的临界区内（用于调试断言）。
+    // 只查看 thread_local 的记录，不会为还没有槽位的线程分配槽位，所以断言开关不改变程序的行为。
+    bool IsPinned() const{
+        Slot *slot = LocalOwner().slot;
+        return slot != nullptr && slot->active.load(std::memory_order_relaxed);
+    }
+
+private:
+    EpochManager() = default;
+
+    void Pin(Slot &slot){
+        uint64_t e = global_.load(std::memory_order_seq_cst);
+        while(true){
+            slot.epoch.store(e, std::memory_order_seq_cst);
+            slot.active.store(true, std::memory_order_seq_cst);
+            // 重新读一次全局 epoch：如果在我们发布自己的 epoch 之前它已经前进了，
+            // 就用新值再发布一次，避免以一个过时的 epoch 进入临界区。
+            uint64_t now = global_.load(std::memory_order_seq_cst);
+            if(now == e){
+                return;
+            }
+            e = now;
+        }
+    }
+
+    // 每个线程记录自己占用的槽位，线程退出时（thread_local 析构）归还。
+    // 归还时槽位里尚未释放的节点留在 limbo 中，由下一个占用者或析构函数释放。
+    struct Owner{
+        Slot *slot = nullptr;
+        ~Owner(){
+            if(slot != nullptr){
+                slot->in_use.store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    static Owner &LocalOwner(){
+        thread_local Owner owner;
+        return owner;
+    }
+
+    // 线程第一次使用时占一个空闲槽位
+    Slot &LocalSlot(){
+        Owner &owner = LocalOwner();
+        if(owner.slot == nullptr){
+            for(auto &slot : slots_){
+                bool expected = false;
+                if(slot.in_use.compare_exchange_strong(expected, true)){
+                    owner.slot = &slot;
+                    break;
+                }
+            }
+            if(owner.slot == nullptr){
+                std::cerr << "EpochManager: more than " << kMaxThreads << " threads" << std::endl;
+                std::abort();
+            }
+        }
+        return *owner.slot;
+    }
+
+    alignas(kCacheLineSize) std::atomic<uint64_t> global_{1};
+    std::array<Slot, kMaxThreads> slots_;
+};
+
+// 分片注册表。分片数 S 和每个分片的桶数 B 都是编译期常量，且必须是 2 的幂，
+// 这里不支持扩容：扩容需要迁移桶，会让无锁读的正确性论证复杂得多。
+template<size_t S = 64, size_t B = 1024>
+class PersonRegistry{
+    static_assert((S & (S - 1)) == 0 && (B & (B - 1)) == 0, "shard and bucket counts must be powers of two");
+
+public:
+    PersonRegistry() = default;
+    PersonRegistry(const PersonRegistry&) = delete;
+    PersonRegistry &operator=(const PersonRegistry&) = delete;
+
+    ~PersonRegistry(){
+        for(auto &shard : shards_){
+            for(auto &bucket : shard.buckets){
+                Node *n = bucket.load(std::memory_order_relaxed);
+                while(n != nullptr){
+                    Node *next = n->next.load(std::memory_order_relaxed);
+                    delete n;
+                    n = next;
+                }
+            }
+        }
+    }
+
+    // 插入一个 Person（移动进注册表）。key 已存在时返回 false，person 保持不变。
+    bool Insert(uint64_t key, Person &&person){
+        uint64_t h = Hash(key);
+        Shard &shard = shards_[h & (S - 1)];
+        std::lock_guard<std::mutex> latch(shard.latch);
+        std::atomic<Node *> &head = shard.buckets[(h >> 32) & (B - 1)];
+        for(Node *n = head.load(std::memory_order_relaxed); n != nullptr; n = n->next.load(std::memory_order_relaxed)){
+            if(n->key == key){
+                return false;
+            }
+        }
+        Node *node = new Node(key, std::move(person));
+        node->next.store(head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        // release：读者通过 acquire 读到这个指针时，一定能看到完整构造好的 Person
+        head.store(node, std::memory_order_release);
+        return true;
+    }
+
+    // 无锁查找。找到时在临界区内调用 reader(person)，reader 不能修改 person，也不能把引用带出去。
+    template<typename F>
+    bool Lookup(uint64_t key, F &&reader){
+        EpochManager::Guard guard(epochs_);
+        uint64_t h = Hash(key);
+        Shard &shard = shards_[h & (S - 1)];
+        Node *n = shard.buckets[(h >> 32) & (B - 1)].load(std::memory_order_acquire);
+        for(; n != nullptr; n = n->next.load(std::memory_order_acquire)){
+            if(n->key == key){
+                reader(n->person);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // 删除：把节点从链表中摘下并交给 EBR，不等待读者，开销与插入相当。
+    bool Remove(uint64_t key){
+        EpochManager::Guard guard(epochs_);
+        Node *node = Unlink(key);
+        if(node == nullptr){
+            return false;
+        }
+        epochs_.Retire(node);
+        return true;
+    }
+
+    // 把记录移出注册表。和 Remove 不同，这里要把 Person 的内容移动给调用者，
+    // 而移动会修改节点中的 Person，所以必须先等到所有可能正在读它的读者离开（等待两次 epoch 前进）。
+    // 这比 Remove 贵得多，只适合不频繁的调用。
+    // 不能在持有 EpochManager::Guard 时调用（例如在 Lookup 的 reader 回调里）：
+    // 当前线程自己停在旧的 epoch 上，全局 epoch 永远无法前进，Extract 会一直等下去。
+    // 调试构建中用断言检查这一点。
+    std::optional<Person> Extract(uint64_t key){
+        assert(!epochs_.IsPinned() && "Extract called inside an epoch critical section");
+        Node *node = Unlink(key);
+        if(node == nullptr){
+            return std::nullopt;
+        }
+        uint64_t target = epochs_.GlobalEpoch() + 2;
+        while(epochs_.GlobalEpoch() < target){
+            if(!epochs_.TryAdvance()){
+                std::this_thread::yield();
+            }
+        }
+        std::optional<Person> out(std::move(node->person));
+        delete node;
+        return out;
+    }
+
+private:
+    struct Node{
+        Node(uint64_t k, Person &&p) : key(k), person(std::move(p)) {}
+        uint64_t key;
+        Person person;
+        std::atomic<Node *> next{nullptr};
+    };
+
+    struct alignas(kCacheLineSize) Shard{
+        std::mutex latch;
+        std::array<std::atomic<Node *>, B> buckets{};
+    };
+
+    // splitmix64 的最后一步，把连续的 key 打散到各个分片和桶
+    static uint64_t Hash(uint64_t x){
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    // 在分片锁内把节点从链表中摘下，返回被摘下的节点（不存在时返回 nullptr）。
+    // 被摘下节点自己的 next 指针保持不变，正在它上面的读者仍然可以继续往后走。
+    Node *Unlink(uint64_t key){
+        uint64_t h = Hash(key);
+        Shard &shard = shards_[h & (S - 1)];
+        std::lock_guard<std::mutex> latch(shard.latch);
+        std::atomic<Node *> *link = &shard.buckets[(h >> 32) & (B - 1)];
+        for(Node *n = link->load(std::memory_order_relaxed); n != nullptr; n = link->load(std::memory_order_relaxed)){
+            if(n->key == key){
+                link->store(n->next.load(std::memory_order_relaxed), std::memory_order_release);
+                return n;
+            }
+            link = &n->next;
+        }
+        return nullptr;
+    }
+
+    EpochManager &epochs_ = EpochManager::Instance();
+    std::array<Shard, S> shards_;
+};
+
+// 作为对照：一个 std::unordered_map，用一把 std::shared_mutex 保护
+class LockedRegistry{
+public:
+    bool Insert(uint64_t key, Person &&person){
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        return map_.try_emplace(key, std::move(person)).second;
+    }
+
+    template<typename F>
+    bool Lookup(uint64_t key, F &&reader){
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = map_.find(key);
+        if(it == map_.end()){
+            return false;
+        }
+        reader(it->second);
+        return true;
+    }
+
+    bool Remove(uint64_t key){
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        return map_.erase(key) != 0;
+    }
+
+    std::optional<Person> Extract(uint64_t key){
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        auto it = map_.find(key);
+        if(it == map_.end()){
+            return std::nullopt;
+        }
+        std::optional<Person> out(std::move(it->second));
+        map_.erase(it);
+        return out;
+    }
+
+private:
+    std::shared_mutex mutex_;
+    std::unordered_map<uint64_t, Person> map_;
+};
+
+// 混合负载：78% 查找，10% 插入，10% 删除，2% 移出（Extract），key 在 [0, key_space) 中均匀分布。
+// 返回每秒操作数。Extract 在分片注册表中要等 epoch 前进两次，是最贵的操作，所以占比较小，
+// 但它和并发的查找交织在一起，等待时间会随读者数量变化。
+template<typename Registry>
+double RunWorkload(Registry &reg, size_t threads, size_t ops_per_thread, uint64_t key_space){
+    std::atomic<uint64_t> checksum{0};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for(size_t t = 0; t < threads; t++){
+        workers.emplace_back([&, t](){
+            uint64_t seed = 0x9e3779b97f4a7c15ULL * (t + 1);
+            uint64_t local = 0;
+            for(size_t i = 0; i < ops_per_thread; i++){
+                seed ^= seed << 13;
+                seed ^= seed >> 7;
+                seed ^= seed << 17;
+                uint64_t key = seed % key_space;
+                uint32_t dice = static_cast<uint32_t>(seed >> 40) % 100;
+                if(dice < 10){
+                    reg.Insert(key, Person(static_cast<uint32_t>(key % 100), {"andy", "pavlo"}));
+                }else if(dice < 20){
+                    reg.Remove(key);
+                }else if(dice < 22){
+                    std::optional<Person> p = reg.Extract(key);
+                    local += p ? p->GetNicknameCount() : 0;
+                }else{
+                    reg.Lookup(key, [&](Person &p){local += p.GetAge();});
+                }
+            }
+            checksum += local;
+        });
+    }
+    for(auto &w : workers){
+        w.join();
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return static_cast<double>(threads * ops_per_thread) / secs;
+}
+
+int main(){
+    // 首先演示基本用法
+    auto registry = std::make_unique<PersonRegistry<>>();
+    registry->Insert(15445, Person(20, {"andy", "pavlo"}));
+    registry->Insert(15721, Person(30, {"jignesh"}));
+    registry->Lookup(15445, [](Person &p){
+        std::cout << "lookup 15445: age " << p.GetAge() << ", nickname " << p.GetNicknameAtI(0) << std::endl;
+    });
+    std::optional<Person> moved = registry->Extract(15721);
+    std::cout << "extracted 15721: age " << moved->GetAge() << ", still present: "
+              << registry->Lookup(15721, [](Person&){}) << std::endl;
+
+    // 然后测量 1 到 N 个线程时的吞吐量
+    const uint64_t key_space = 100000;
+    const size_t ops_per_thread = 200000;
+    size_t max_threads = std::thread::hardware_concurrency();
+    if(max_threads < 4){
+        max_threads = 4;
+    }
+    for(size_t threads = 1; threads <= max_threads; threads *= 2){
+        auto sharded = std::make_unique<PersonRegistry<>>();
+        LockedRegistry locked;
+        for(uint64_t k = 0; k < key_space; k += 2){
+            sharded->Insert(k, Person(static_cast<uint32_t>(k % 100), {"andy", "pavlo"}));
+            locked.Insert(k, Person(static_cast<uint32_t>(k % 100), {"andy", "pavlo"}));
+        }
+        double a = RunWorkload(*sharded, threads, ops_per_thread, key_space);
+        double b = RunWorkload(locked, threads, ops_per_thread, key_space);
+        std::cout << threads << " thread(s): sharded + EBR " << a / 1e6 << " M ops/s, shared_mutex map "
+                  << b / 1e6 << " M ops/s" << std::endl;
+    }
+    return 0;
+}
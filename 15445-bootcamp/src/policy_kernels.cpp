@@ -0,0 +1,310 @@
+// 基于模板参数的编译期特化内核（kernel）教程代码
+
+// templated_functions.cpp 里的 add3<bool T> 展示了一个想法：
+// 把运行时的 if 分支变成模板参数，编译器为 add3<true> 和 add3<false> 各生成一份没有分支的代码。
+// 但它只覆盖了一个 bool。这个文件把它推广成一个"策略（policy）"框架：
+// - 数据类型（uint32_t / int64_t / double）是模板类型参数；
+// - 比较运算符（< <= == != >= >）、算术运算符（+ - *）是枚举类型的非类型模板参数；
+// - 是否需要处理 NULL 是一个 bool 模板参数，不可能有 NULL 的列不会为它付出任何代价；
+// - 每一种组合只实例化一次，放进一张函数指针表（dispatch table）里。数据类型也是表的一维：
+//   列的类型往往要到查询准备时才知道，表里存的是接收 const void * 的包装函数，内部再转成具体类型。
+//   "查询准备"阶段根据运行时的类型和过滤条件查一次表，得到一个函数指针；
+//   真正执行时内层循环里没有任何关于类型或运算符的 switch。
+// 作为对照，我们也实现一个"解释执行"的版本：每一行都重新读取运算符并 switch 一次，再判断一次 NULL。
+// 两个版本都用 branch-free 的方式写入选中的行号，计时的差别只来自每行的 switch。
+//
+// 编译：g++ -std=c++17 -O2 policy_kernels.cpp -o policy_kernels
+
+#include<iostream>
+#include<utility>
+#include<algorithm>
+#include<array>
+#include<cstdint>
+#include<tuple>
+#include<vector>
+#include<chrono>
+
+enum class CmpOp : uint8_t {kLt, kLe, kEq, kNe, kGe, kGt};
+enum class ArithOp : uint8_t {kAdd, kSub, kMul};
+enum class DataType : uint8_t {kUInt32, kInt64, kDouble};
+constexpr size_t kNumCmpOps = 6;
+constexpr size_t kNumArithOps = 3;
+constexpr size_t kNumDataTypes = 3;
+
+// DataType 到 C++ 类型的映射，顺序与 DataType 的枚举值相同
+using ColumnTypes = std::tuple<uint32_t, int64_t, double>;
+template<size_t D>
+using ColumnType = std::tuple_element_t<D, ColumnTypes>;
+
+// 和 add3<bool T> 中的 if(T) 一样，这里的 if constexpr 在编译期就确定走哪一支，
+// 生成的代码里只剩下一条比较指令。
+template<CmpOp Op, typename T>
+inline bool Compare(T a, T b){
+    if constexpr(Op == CmpOp::kLt) {return a < b;}
+    else if constexpr(Op == CmpOp::kLe) {return a <= b;}
+    else if constexpr(Op == CmpOp::kEq) {return a == b;}
+    else if constexpr(Op == CmpOp::kNe) {return a != b;}
+    else if constexpr(Op == CmpOp::kGe) {return a >= b;}
+    else {return a > b;}
+}
+
+template<ArithOp Op, typename T>
+inline T Apply(T a, T b){
+    if constexpr(Op == ArithOp::kAdd) {return a + b;}
+    else if constexpr(Op == ArithOp::kSub) {return a - b;}
+    else {return a * b;}
+}
+
+// 过滤内核：把满足 col[i] Op constant 的行号写入 out_rows，返回个数。
+// HasNulls 为 false 时 nulls 参数完全不会被读取。
+// 写法上不用 if 决定是否写入，而是每行都写、再按比较结果推进下标（branch-free selection），
+// 这样选择率在 50% 左右时也不会因为分支预测失败而变慢。
+// 代价是每一行都会写 out_rows[k]（包括不满足条件的行），所以 out_rows 必须能容纳 n 个元素，
+// 不能按预估的选择率分配，否则会越界写。
+template<typename T, CmpOp Op, bool HasNulls>
+size_t FilterKernel(const T *col, const uint8_t *nulls, size_t n, T constant, uint32_t *out_rows){
+    size_t k = 0;
+    for(size_t i = 0; i < n; i++){
+        bool keep = Compare<Op>(col[i], constant);
+        if constexpr(HasNulls){
+            // 用 & 而不是 &&：&& 的短路求值会重新引入一个分支
+            keep = keep & (nulls[i] == 0);
+        }
+        out_rows[k] = static_cast<uint32_t>(i);
+        k += keep;
+    }
+    return k;
+}
+
+// 算术内核：out[i] = col[i] Op constant。NULL 行的结果没有意义，但仍然计算（比判断更便宜），
+// 调用者依据同一个 nulls 位图忽略它们。所以算术内核不需要 HasNulls 参数。
+// __restrict 告诉编译器 col 和 out 不重叠，循环可以直接向量化，不需要运行时的重叠检查。
+template<typename T, ArithOp Op>
+void ArithKernel(const T *__restrict col, size_t n, T constant, T *__restrict out){
+    for(size_t i = 0; i < n; i++){
+        out[i] = Apply<Op>(col[i], constant);
+    }
+}
+
+template<typename T>
+using FilterFn = size_t (*)(const T *, const uint8_t *, size_t, T, uint32_t *);
+template<typename T>
+using ArithFn = void (*)(const T *, size_t, T, T *);
+
+// 用 index_sequence 在编译期展开出 [比较运算符][是否有 NULL] 的全部组合，
+// 生成一张 constexpr 的函数指针表。表里每一项都是一个独立实例化的内核。
+template<typename T, size_t... I>
+constexpr std::array<std::array<FilterFn<T>, 2>, kNumCmpOps> MakeFilterTable(std::index_sequence<I...>){
+    return {{{&FilterKernel<T, static_cast<CmpOp>(I), false>, &FilterKernel<T, static_cast<CmpOp>(I), true>}...}};
+}
+
+template<typename T, size_t... I>
+constexpr std::array<ArithFn<T>, kNumArithOps> MakeArithTable(std::index_sequence<I...>){
+    return {{&ArithKernel<T, static_cast<ArithOp>(I)>...}};
+}
+
+template<typename T>
+constexpr auto kFilterTable = MakeFilterTable<T>(std::make_index_sequence<kNumCmpOps>{});
+template<typename T>
+constexpr auto kArithTable = MakeArithTable<T>(std::make_index_sequence<kNumArithOps>{});
+
+// 查询准备阶段：运行时的条件只在这里查一次表。T 在编译期已知时用这两个版本。
+template<typename T>
+FilterFn<T> PrepareFilter(CmpOp op, bool has_nulls){
+    return kFilterTable<T>[static_cast<size_t>(op)][has_nulls ? 1 : 0];
+}
+
+template<typename T>
+ArithFn<T> PrepareArith(ArithOp op){
+    return kArithTable<T>[static_cast<size_t>(op)];
+}
+
+// 类型擦除的内核：col、constant、out 指向 DataType 对应的 C++ 类型。
+// 包装函数只做指针转换，编译器会把具体的内核内联进来，内层循环和上面的版本完全相同。
+using AnyFilterFn = size_t (*)(const void *, const uint8_t *, size_t, const void *, uint32_t *);
+using AnyArithFn = void (*)(const void *, size_t, const void *, void *);
+
+template<typename T, CmpOp Op, bool HasNulls>
+size_t AnyFilter(const void *col, const uint8_t *nulls, size_t n, const void *constant, uint32_t *out_rows){
+    return FilterKernel<T, Op, HasNulls>(static_cast<const T *>(col), nulls, n, *static_cast<const T *>(constant),
+                                         out_rows);
+}
+
+template<typename T, ArithOp Op>
+void AnyArith(const void *col, size_t n, const void *constant, void *out){
+    ArithKernel<T, Op>(static_cast<const T *>(col), n, *static_cast<const T *>(constant), static_cast<T *>(out));
+}
+
+// [数据类型][比较运算符][是否有 NULL] 和 [数据类型][算术运算符] 两张表，同样在编译期展开
+template<typename T, size_t... I>
+constexpr std::array<std::array<AnyFilterFn, 2>, kNumCmpOps> MakeAnyFilterRow(std::index_sequence<I...>){
+    return {{{&AnyFilter<T, static_cast<CmpOp>(I), false>, &AnyFilter<T, static_cast<CmpOp>(I), true>}...}};
+}
+
+template<size_t... D>
+constexpr std::array<std::array<std::array<AnyFilterFn, 2>, kNumCmpOps>, kNumDataTypes>
+MakeAnyFilterTable(std::index_sequence<D...>){
+    return {{MakeAnyFilterRow<ColumnType<D>>(std::make_index_sequence<kNumCmpOps>{})...}};
+}
+
+template<typename T, size_t... I>
+constexpr std::array<AnyArithFn, kNumArithOps> MakeAnyArithRow(std::index_sequence<I...>){
+    return {{&AnyArith<T, static_cast<ArithOp>(I)>...}};
+}
+
+template<size_t... D>
+constexpr std::array<std::array<AnyArithFn, kNumArithOps>, kNumDataTypes> MakeAnyArithTable(std::index_sequence<D...>){
+    return {{MakeAnyArithRow<ColumnType<D>>(std::make_index_sequence<kNumArithOps>{})...}};
+}
+
+constexpr auto kAnyFilterTable = MakeAnyFilterTable(std::make_index_sequence<kNumDataTypes>{});
+constexpr auto kAnyArithTable = MakeAnyArithTable(std::make_index_sequence<kNumDataTypes>{});
+
+// 列类型在运行时才知道时用这两个版本：类型也只在这里查一次表，不需要调用者写 switch。
+AnyFilterFn PrepareFilter(DataType type, CmpOp op, bool has_nulls){
+    return kAnyFilterTable[static_cast<size_t>(type)][static_cast<size_t>(op)][has_nulls ? 1 : 0];
+}
+
+AnyArithFn PrepareArith(DataType type, ArithOp op){
+    return kAnyArithTable[static_cast<size_t>(type)][static_cast<size_t>(op)];
+}
+
+// 作为对照的解释执行版本：运算符和 NULL 检查都是运行时参数，每一行都要 switch 一次。
+// 如果按值传入 op，编译器会发现它在循环里不变，把 switch 提到循环外面、为每个分支各生成一个循环
+// （loop unswitching），"解释执行"就悄悄变成了特化版本。真正的解释器每一行都要重新读取表达式节点，
+// 所以这里通过 volatile 引用传入，每一行都从内存重新读一次运算符和 has_nulls。
+template<typename T>
+size_t InterpretedFilter(const T *col, const uint8_t *nulls, size_t n, T constant, const volatile CmpOp &op,
+                         const volatile bool &has_nulls, uint32_t *out_rows){
+    size_t k = 0;
+    for(size_t i = 0; i < n; i++){
+        bool keep = false;
+        switch(op){
+            case CmpOp::kLt: keep = col[i] < constant; break;
+            case CmpOp::kLe: keep = col[i] <= constant; break;
+            case CmpOp::kEq: keep = col[i] == constant; break;
+            case CmpOp::kNe: keep = col[i] != constant; break;
+            case CmpOp::kGe: keep = col[i] >= constant; break;
+            case CmpOp::kGt: keep = col[i] > constant; break;
+        }
+        if(has_nulls){
+            keep = keep & (nulls[i] == 0);
+        }
+        // 与 FilterKernel 相同的 branch-free 写法，out_rows 同样需要 n 个元素的空间
+        out_rows[k] = static_cast<uint32_t>(i);
+        k += keep;
+    }
+    return k;
+}
+
+template<typename T>
+void InterpretedArith(const T *col, size_t n, T constant, const volatile ArithOp &op, T *out){
+    for(size_t i = 0; i < n; i++){
+        switch(op){
+            case ArithOp::kAdd: out[i] = col[i] + constant; break;
+            case ArithOp::kSub: out[i] = col[i] - constant; break;
+            case ArithOp::kMul: out[i] = col[i] * constant; break;
+        }
+    }
+}
+
+// 防止编译器因为结果没被使用而把被测代码删掉
+template<typename T>
+inline void DoNotOptimize(const T &value){
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+int main(){
+    // Person 的 age 列：一百万个 18~97 之间的年龄，大约 5% 是 NULL
+    const size_t n = 1 << 20;
+    std::vector<uint32_t> ages(n);
+    std::vector<uint8_t> nulls(n);
+    uint32_t seed = 15445;
+    for(size_t i = 0; i < n; i++){
+        seed = seed * 1103515245 + 12345;
+        ages[i] = 18 + (seed >> 16) % 80;
+        nulls[i] = ((seed >> 8) % 20) == 0;
+    }
+    std::vector<uint32_t> rows(n);
+    std::vector<uint32_t> out(n);
+    // 解释执行版本的运算符放在 volatile 变量里，见 InterpretedFilter 前的说明
+    volatile CmpOp cmp_op = CmpOp::kGe;
+    volatile bool nullable = true;
+    volatile ArithOp arith_op = ArithOp::kAdd;
+
+    // 先确认两种实现选出的是同一批行，而不只是个数相同。
+    // age 列的类型在这里当作运行时才知道的信息，通过 DataType 查表。
+    const uint32_t kAge50 = 50;
+    std::vector<uint32_t> rows_interpreted(n);
+    auto filter = PrepareFilter(DataType::kUInt32, CmpOp::kGe, true);
+    size_t k1 = filter(ages.data(), nulls.data(), n, &kAge50, rows.data());
+    size_t k2 = InterpretedFilter<uint32_t>(ages.data(), nulls.data(), n, 50, cmp_op, nullable,
+                                            rows_interpreted.data());
+    bool same_rows = k1 == k2 && std::equal(rows.begin(), rows.begin() + k1, rows_interpreted.begin());
+    std::cout << "age >= 50 (nulls excluded): specialized " << k1 << ", interpreted " << k2
+              << (same_rows ? ", same rows" : ", ROWS DIFFER") << std::endl;
+
+    // 其他数据类型也使用同一套表：编译期已知类型时用模板版本，运行时才知道时用 DataType
+    std::vector<double> scores = {1.5, 2.5, 3.5};
+    std::vector<double> scaled(3);
+    PrepareArith<double>(ArithOp::kMul)(scores.data(), scores.size(), 2.0, scaled.data());
+    std::cout << "scores * 2.0: " << scaled[0] << " " << scaled[1] << " " << scaled[2] << std::endl;
+    std::vector<int64_t> ids = {-3, 15445, 15721};
+    std::vector<uint32_t> id_rows(ids.size());
+    const int64_t kZero = 0;
+    size_t positive = PrepareFilter(DataType::kInt64, CmpOp::kGt, false)(ids.data(), nullptr, ids.size(), &kZero,
+                                                                         id_rows.data());
+    std::cout << "ids > 0: " << positive << " rows, first is row " << id_rows[0] << std::endl;
+
+    const int kRounds = 50;
+    const CmpOp ops[] = {CmpOp::kLt, CmpOp::kGe, CmpOp::kEq};
+    const char *op_names[] = {"<", ">=", "=="};
+    for(size_t o = 0; o < 3; o++){
+        for(bool has_nulls : {false, true}){
+            auto fn = PrepareFilter(DataType::kUInt32, ops[o], has_nulls);
+            cmp_op = ops[o];
+            nullable = has_nulls;
+            auto t0 = std::chrono::steady_clock::now();
+            for(int r = 0; r < kRounds; r++){
+                DoNotOptimize(fn(ages.data(), nulls.data(), n, &kAge50, rows.data()));
+            }
+            auto t1 = std::chrono::steady_clock::now();
+            for(int r = 0; r < kRounds; r++){
+                DoNotOptimize(InterpretedFilter<uint32_t>(ages.data(), nulls.data(), n, 50, cmp_op, nullable,
+                                                          rows_interpreted.data()));
+            }
+            auto t2 = std::chrono::steady_clock::now();
+            auto rows_per_ns = [&](auto a, auto b){
+                return static_cast<double>(n) * kRounds / std::chrono::duration<double, std::nano>(b - a).count();
+            };
+            std::cout << "filter age " << op_names[o] << " 50" << (has_nulls ? " (nullable)" : "           ")
+                      << ": specialized " << rows_per_ns(t0, t1) << " rows/ns, interpreted "
+                      << rows_per_ns(t1, t2) << " rows/ns" << std::endl;
+        }
+    }
+
+    auto add = PrepareArith(DataType::kUInt32, ArithOp::kAdd);
+    const uint32_t kThree = 3;
+    // 两个版本各预热一次，让输出数组的页面先被真正分配，避免缺页时间算进计时
+    std::vector<uint32_t> out_interpreted(n);
+    add(ages.data(), n, &kThree, out.data());
+    InterpretedArith<uint32_t>(ages.data(), n, 3, arith_op, out_interpreted.data());
+    auto t0 = std::chrono::steady_clock::now();
+    for(int r = 0; r < kRounds; r++){
+        add(ages.data(), n, &kThree, out.data());
+        DoNotOptimize(out[r]);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for(int r = 0; r < kRounds; r++){
+        InterpretedArith<uint32_t>(ages.data(), n, 3, arith_op, out_interpreted.data());
+        DoNotOptimize(out_interpreted[r]);
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    bool same_out = out == out_interpreted;
+    auto rows_per_ns = [&](auto a, auto b){
+        return static_cast<double>(n) * kRounds / std::chrono::duration<double, std::nano>(b - a).count();
+    };
+    std::cout << "age + 3: specialized " << rows_per_ns(t0, t1) << " rows/ns, interpreted "
+              << rows_per_ns(t1, t2) << " rows/ns" << (same_out ? "" : " (RESULTS DIFFER)") << std::endl;
+    return 0;
+}